@@ -5,14 +5,22 @@
  * 1. Conectividade MQTT: Broker revertido para 'broker.hivemq.com' (porta 1883, sem credenciais).
  * 2. Variação do BPM: Implementada a função generateHeartRate() para variar o BPM suavemente.
  * 3. Conectividade MQTT: Cliente WiFiClient e porta 1883 mantidos.
+ * 4. Sincronização: agregados de 1 min / 1 h enviados antes do backlog bruto.
+ * 5. Transporte TLS opcional (-DMQTT_USE_TLS, porta 8883) com retomada de sessão.
+ * 6. Sequência persistente + época de boot + encarnação em cada registro (dedupe no fog).
  */
 
 #include <WiFi.h>
 #include <WiFiClient.h> // Cliente Padrão (não-seguro)
 #include <DHT.h>
 #include <LittleFS.h>
+#include <Preferences.h>
 #include <ArduinoJson.h>
 #include <PubSubClient.h>
+#include "rollups.h" // Agregados 1 min / 1 h (sem dependência do Arduino)
+#ifdef MQTT_USE_TLS
+#include "tls_session_client.h" // Cliente TLS com retomada de sessão
+#endif
 
 // ==================== CONFIGURAÇÕES DOS SENSORES ====================
 #define DHT_PIN 4
@@ -29,10 +37,25 @@ const char* ssid = "Wokwi-GUEST";
 const char* password = "";
 
 // ==================== CONFIGURAÇÕES MQTT ====================
+#ifdef MQTT_USE_TLS
+// Broker local com TLS (ver env:esp32dev_tls no platformio.ini)
+#ifndef MQTT_TLS_HOST
+#define MQTT_TLS_HOST "192.168.1.100"
+#endif
+const char* mqtt_server = MQTT_TLS_HOST;
+const int mqtt_port = 8883;
+// Cole aqui o conteúdo de ca.crt (PEM). Sem CA a conexão é recusada, a menos
+// que o build defina -DMQTT_TLS_INSECURE (apenas testes locais)
+const char* mqtt_ca_cert = nullptr;
+#else
 const char* mqtt_server = "broker.hivemq.com"; // <<< CORREÇÃO: Revertido para broker.hivemq.com
 const int mqtt_port = 1883;
+#endif
 const char* mqtt_client_id = "ESP32_Medical_001_LCV"; 
 // As credenciais de login/senha foram removidas para usar a porta pública 1883
+// Broker tolera 90s sem PING: a conexão sobrevive à queda simulada de 45s e é
+// reutilizada sem reconectar. -DMQTT_DROP_ON_OUTAGE força a reconexão.
+const uint16_t MQTT_KEEPALIVE = 60;
 
 // Tópicos MQTT
 const char* topic_temperature = "fiap/medical/temperature";
@@ -41,10 +64,15 @@ const char* topic_heartrate = "fiap/medical/heartrate";
 const char* topic_alldata = "fiap/medical/alldata";
 const char* topic_alert = "fiap/medical/alert";
 const char* topic_status = "fiap/medical/status";
+const char* topic_rollup = "fiap/medical/rollup";
 
 // ==================== OBJETOS ====================
 DHT dht(DHT_PIN, DHT_TYPE);
+#ifdef MQTT_USE_TLS
+TlsSessionClient espClient;
+#else
 WiFiClient espClient; 
+#endif
 PubSubClient mqttClient(espClient);
 
 // ==================== VARIÁVEIS DE CONTROLE ====================
@@ -63,6 +91,22 @@ const unsigned long HR_UPDATE_INTERVAL = 10000; // Varia BPM a cada 10s
 unsigned long lastWifiToggle = 0;
 const unsigned long WIFI_TOGGLE_INTERVAL = 45000; // Alternar a cada 45s
 
+// ==================== NÚMERO DE SEQUÊNCIA ====================
+// 'seq' cresce monotonicamente entre reinícios e identifica cada registro;
+// 'epoch' conta os boots. 'incarnation' é um ID aleatório criado quando a
+// NVS está vazia: se ela for apagada, seq e epoch recomeçam, mas o fog
+// reconhece a nova encarnação e não confunde os registros com reenvios.
+// A NVS só é gravada a cada bloco reservado, poupando a Flash.
+const uint32_t SEQ_RESERVE_BLOCK = 100;
+Preferences prefs;
+uint32_t incarnation = 0;
+uint32_t bootEpoch = 0;
+uint32_t nextSeq = 1;
+uint32_t seqCeiling = 1;
+// Maior seq que não foi enviado ao vivo (chegará pelo backlog). Permite ao
+// fog não reter leituras ao vivo esperando por lacunas que o backlog cobre.
+uint32_t backlogThroughSeq = 0;
+
 // ==================== CONFIGURAÇÕES DE ARMAZENAMENTO ====================
 const int MAX_STORED_READINGS = 1000; // Limite de amostras offline
 
@@ -72,6 +116,9 @@ struct SensorData {
   float humidity;
   int heartRate;
   unsigned long timestamp;
+  uint32_t seq;    // Sequência monotônica do dispositivo (0 = registro legado)
+  uint32_t epoch;  // Boot em que o registro foi gerado
+  uint32_t incarnation; // Encarnação da NVS em que o seq foi gerado
   bool sent;
 };
 
@@ -80,6 +127,13 @@ SensorData offlineBuffer[MAX_STORED_READINGS];
 int bufferIndex = 0;
 int totalStored = 0;
 
+// ==================== ROLLUPS MULTI-RESOLUÇÃO ====================
+// Anéis de 1 min / 1 h dos dados offline (ver rollups.h)
+RollupRings rollups = {};
+// Falhas seguidas de envio toleradas antes de desistir dos agregados:
+// o backlog bruto cobre o mesmo período e não pode ficar bloqueado
+const int MAX_ROLLUP_ATTEMPTS = 3;
+
 // ==================== DECLARAÇÃO DE FUNÇÕES (PROTÓTIPOS) ====================
 void setupWiFi();
 void checkWiFiConnection();
@@ -91,13 +145,20 @@ int generateHeartRate();
 void storeData(SensorData data);
 void saveToLittleFS(SensorData data);
 void loadOfflineData();
+void setupSequence();
+uint32_t nextSequenceNumber();
 void syncOfflineData();
+void syncRollups();
+bool sendRollupToCloud(const RollupBucket& bucket, const char* resolution);
 bool sendDataToCloud(SensorData data);
 void checkAlerts(SensorData data);
 void clearOfflineData();
 void testLEDs();
 void blinkMQTTLED();
 void printFileSystemInfo();
+#ifdef MQTT_USE_TLS
+void printTLSStats();
+#endif
 
 // ==================== SETUP ====================
 void setup() {
@@ -141,6 +202,9 @@ void setup() {
     Serial.println("ℹ️  Sistema funcionará apenas com armazenamento em RAM");
   }
   
+  // Restaurar sequência e registrar novo boot
+  setupSequence();
+  
   // Carregar dados offline salvos
   loadOfflineData();
   
@@ -171,6 +235,12 @@ void loop() {
     if (!mqttClient.connected()) {
       reconnectMQTT();
     } else {
+      if (!mqttConnected) {
+        // Sessão MQTT sobreviveu à queda: reutilizar sem novo handshake
+        mqttConnected = true;
+        digitalWrite(MQTT_LED_PIN, HIGH);
+        Serial.println("\n♻️  Conexão MQTT reutilizada (sem novo handshake)");
+      }
       mqttClient.loop();
     }
   }
@@ -187,8 +257,10 @@ void loop() {
     lastSensorRead = millis();
   }
   
-  // Tentar sincronizar dados offline
-  if (wifiConnected && mqttConnected && totalStored > 0) {
+  // Tentar sincronizar dados offline: agregados primeiro, brutos depois
+  if (wifiConnected && mqttConnected && (rollups.minuteCount > 0 || rollups.hourCount > 0)) {
+    syncRollups();
+  } else if (wifiConnected && mqttConnected && totalStored > 0) {
     syncOfflineData();
   }
   
@@ -291,6 +363,11 @@ void checkWiFiConnection() {
       digitalWrite(WIFI_LED_PIN, LOW);
       digitalWrite(MQTT_LED_PIN, LOW);
       mqttConnected = false;
+#ifdef MQTT_DROP_ON_OUTAGE
+      // Derruba a conexão como numa queda real: a volta exige novo handshake
+      // (com a variante TLS, exercita a retomada de sessão a cada ciclo)
+      mqttClient.disconnect();
+#endif
       Serial.println("\n╔════════════════════════════════════════════════════════╗");
       Serial.println("║        🔴 WiFi DESCONECTADO - OPERANDO OFFLINE        ║");
       Serial.println("╚════════════════════════════════════════════════════════╝");
@@ -305,11 +382,29 @@ void checkWiFiConnection() {
 void setupMQTT() {
   mqttClient.setServer(mqtt_server, mqtt_port);
   mqttClient.setCallback(mqttCallback);
+  mqttClient.setBufferSize(512); // Payload de agregados excede o padrão de 256 bytes
+  mqttClient.setKeepAlive(MQTT_KEEPALIVE);
+#ifdef MQTT_USE_TLS
+  espClient.setCACert(mqtt_ca_cert);
+#ifdef MQTT_TLS_INSECURE
+  espClient.setInsecure();
+#endif
+#endif
   Serial.println("\n🌐 MQTT configurado:");
   Serial.print("   Broker: ");
   Serial.println(mqtt_server);
   Serial.print("   Porta: ");
   Serial.println(mqtt_port);
+#ifdef MQTT_USE_TLS
+  Serial.println("   Transporte: 🔐 TLS com retomada de sessão");
+  if (mqtt_ca_cert == nullptr) {
+#ifdef MQTT_TLS_INSECURE
+    Serial.println("   ⚠️  MQTT_TLS_INSECURE: certificado do broker NÃO verificado");
+#else
+    Serial.println("   ❌ Sem CA (mqtt_ca_cert): conexões TLS serão recusadas");
+#endif
+  }
+#endif
 }
 
 // ==================== RECONEXÃO MQTT ====================
@@ -333,7 +428,23 @@ void reconnectMQTT() {
       digitalWrite(MQTT_LED_PIN, HIGH);
       
       // Publicar status online
+#ifdef MQTT_USE_TLS
+      printTLSStats();
+      
+      const TlsHandshakeStats& tls = espClient.stats();
+      DynamicJsonDocument statusDoc(256);
+      statusDoc["status"] = "online";
+      statusDoc["device"] = "ESP32_Medical_001";
+      statusDoc["tls_resumed"] = tls.lastResumed;
+      statusDoc["tls_handshake_ms"] = tls.lastMs;
+      statusDoc["tls_handshake_bytes"] = tls.lastBytes;
+      
+      String statusPayload;
+      serializeJson(statusDoc, statusPayload);
+      mqttClient.publish(topic_status, statusPayload.c_str());
+#else
       mqttClient.publish(topic_status, "{\"status\":\"online\",\"device\":\"ESP32_Medical_001\"}");
+#endif
       
       Serial.println("🟢 LED Verde: MQTT ativo");
     } else {
@@ -346,6 +457,40 @@ void reconnectMQTT() {
   }
 }
 
+#ifdef MQTT_USE_TLS
+// ==================== CUSTO DOS HANDSHAKES TLS ====================
+void printTLSStats() {
+  const TlsHandshakeStats& tls = espClient.stats();
+  
+  Serial.print("🔐 Handshake TLS: ");
+  Serial.print(tls.lastResumed ? "RETOMADO" : "COMPLETO");
+  Serial.print(" | ");
+  Serial.print(tls.lastMs);
+  Serial.print(" ms | ");
+  Serial.print(tls.lastBytes);
+  Serial.println(" bytes");
+  
+  if (tls.fullCount > 0) {
+    Serial.print("   Completos: ");
+    Serial.print(tls.fullCount);
+    Serial.print(" (média ");
+    Serial.print(tls.fullMsTotal / tls.fullCount);
+    Serial.print(" ms, ");
+    Serial.print(tls.fullBytesTotal / tls.fullCount);
+    Serial.println(" bytes)");
+  }
+  if (tls.resumedCount > 0) {
+    Serial.print("   Retomados: ");
+    Serial.print(tls.resumedCount);
+    Serial.print(" (média ");
+    Serial.print(tls.resumedMsTotal / tls.resumedCount);
+    Serial.print(" ms, ");
+    Serial.print(tls.resumedBytesTotal / tls.resumedCount);
+    Serial.println(" bytes)");
+  }
+}
+#endif
+
 // ==================== CALLBACK MQTT ====================
 void mqttCallback(char* topic, byte* payload, unsigned int length) {
   Serial.print("📥 Mensagem recebida [");
@@ -378,6 +523,9 @@ void readSensors() {
   data.humidity = humidity;
   data.heartRate = heartRate; // Usa o valor simulado e variado
   data.timestamp = millis();
+  data.seq = nextSequenceNumber();
+  data.epoch = bootEpoch;
+  data.incarnation = incarnation;
   data.sent = false;
   
   // Exibir dados
@@ -403,9 +551,14 @@ void readSensors() {
   // Armazenar dados localmente
   storeData(data);
   
-  // Enviar para nuvem se conectado
-  if (wifiConnected && mqttConnected) {
-    sendDataToCloud(data);
+  // Agregar o que não será enviado agora
+  if (!wifiConnected || !mqttConnected) {
+    addRollupSample(rollups, data.timestamp, data.seq, data.temperature, data.humidity, data.heartRate);
+  }
+  
+  // Enviar para nuvem se conectado; o que não sair agora vem pelo backlog
+  if (!(wifiConnected && mqttConnected && sendDataToCloud(data))) {
+    backlogThroughSeq = data.seq;
   }
   
   Serial.println("└────────────────────────────────────────────┘\n");
@@ -452,6 +605,9 @@ void saveToLittleFS(SensorData data) {
   doc["hum"] = data.humidity;
   doc["hr"] = data.heartRate;
   doc["ts"] = data.timestamp;
+  doc["seq"] = data.seq;
+  doc["ep"] = data.epoch;
+  doc["inc"] = data.incarnation;
   doc["sent"] = data.sent;
   
   serializeJson(doc, file);
@@ -459,6 +615,39 @@ void saveToLittleFS(SensorData data) {
   file.close();
 }
 
+// ==================== SEQUÊNCIA PERSISTENTE ====================
+void setupSequence() {
+  prefs.begin("medical", false);
+  
+  incarnation = prefs.getULong("incarnation", 0);
+  if (incarnation == 0) {
+    incarnation = esp_random() | 1; // Nunca zero: zero marca NVS vazia
+    prefs.putULong("incarnation", incarnation);
+  }
+  
+  bootEpoch = prefs.getULong("boot_epoch", 0) + 1;
+  prefs.putULong("boot_epoch", bootEpoch);
+  
+  // Recomeça do teto reservado: números não usados no boot anterior são pulados
+  nextSeq = prefs.getULong("seq_ceiling", 1);
+  seqCeiling = nextSeq;
+  // Seqs anteriores ou estão no backlog ou nunca serão usados
+  backlogThroughSeq = nextSeq - 1;
+  
+  Serial.print("\n🔢 Boot #");
+  Serial.print(bootEpoch);
+  Serial.print(" | Próxima sequência: ");
+  Serial.println(nextSeq);
+}
+
+uint32_t nextSequenceNumber() {
+  if (nextSeq >= seqCeiling) {
+    seqCeiling = nextSeq + SEQ_RESERVE_BLOCK;
+    prefs.putULong("seq_ceiling", seqCeiling);
+  }
+  return nextSeq++;
+}
+
 // ==================== CARREGAR DADOS OFFLINE ====================
 void loadOfflineData() {
   Serial.println("\n📂 Carregando dados offline...");
@@ -489,8 +678,13 @@ void loadOfflineData() {
         offlineBuffer[totalStored].humidity = doc["hum"];
         offlineBuffer[totalStored].heartRate = doc["hr"];
         offlineBuffer[totalStored].timestamp = doc["ts"];
+        offlineBuffer[totalStored].seq = doc["seq"] | 0;
+        offlineBuffer[totalStored].epoch = doc["ep"] | 0;
+        offlineBuffer[totalStored].incarnation = doc["inc"] | incarnation;
         offlineBuffer[totalStored].sent = false;
         
+        // Sem agregados para boots anteriores: o millis() deles não tem
+        // referência de tempo neste boot. Seguem apenas como backlog bruto.
         totalStored++;
       }
     }
@@ -546,6 +740,104 @@ void syncOfflineData() {
   }
 }
 
+// ==================== SINCRONIZAR ROLLUPS ====================
+void syncRollups() {
+  static unsigned long lastSync = 0;
+  static int failures = 0;
+
+  // Mesmo ritmo do backlog bruto entre tentativas após uma falha
+  if (failures > 0 && millis() - lastSync < 2000) {
+    return;
+  }
+  lastSync = millis();
+
+  Serial.println("\n📈 ═══════════════════════════════════════");
+  Serial.println("   SINCRONIZANDO AGREGADOS OFFLINE");
+  Serial.println("   ═══════════════════════════════════════");
+
+  // Anéis disjuntos: 1 h cobre o início da queda, 1 min o trecho recente.
+  // Cada bucket enviado sai do anel, então uma falha no meio não reenvia nada.
+  int sentCount = 0;
+  bool ok = true;
+
+  while (ok && rollups.hourCount > 0) {
+    ok = sendRollupToCloud(rollups.hour[0], "1h");
+    if (ok) {
+      shiftRollupRing(rollups.hour, rollups.hourCount);
+      sentCount++;
+    }
+  }
+
+  while (ok && rollups.minuteCount > 0) {
+    ok = sendRollupToCloud(rollups.minute[0], "1m");
+    if (ok) {
+      shiftRollupRing(rollups.minute, rollups.minuteCount);
+      sentCount++;
+    }
+  }
+
+  if (!ok) {
+    failures++;
+    if (failures < MAX_ROLLUP_ATTEMPTS) {
+      Serial.println("   ❌ Falha ao enviar agregado - nova tentativa em breve");
+      return;
+    }
+    // Falha persistente: o backlog bruto cobre o período, segue sem agregados
+    Serial.println("   ❌ Agregados descartados após falhas seguidas - seguindo com o backlog bruto");
+    clearRollups(rollups);
+    failures = 0;
+    Serial.println("   ═══════════════════════════════════════\n");
+    return;
+  }
+  failures = 0;
+
+  Serial.print("   ✅ ");
+  Serial.print(sentCount);
+  Serial.println(" agregados enviados - dashboard coberto");
+  Serial.print("   📦 Amostras brutas em segundo plano: ");
+  Serial.println(totalStored);
+  Serial.println("   ═══════════════════════════════════════\n");
+}
+
+bool sendRollupToCloud(const RollupBucket& bucket, const char* resolution) {
+  DynamicJsonDocument doc(768);
+  doc["device_id"] = mqtt_client_id;
+  doc["resolution"] = resolution;
+  doc["start"] = bucket.start;
+  doc["end"] = bucket.end;
+  doc["count"] = bucket.count;
+  doc["seq_first"] = bucket.seqFirst;
+  doc["seq_last"] = bucket.seqLast;
+  doc["epoch"] = bootEpoch; // Anéis só na RAM: sempre do boot atual
+  doc["incarnation"] = incarnation;
+  doc["device_now"] = millis(); // Referência para converter millis em hora real
+
+  JsonObject temp = doc.createNestedObject("temperature");
+  temp["min"] = bucket.temperature.min;
+  temp["mean"] = bucket.temperature.sum / bucket.count;
+  temp["max"] = bucket.temperature.max;
+
+  JsonObject hum = doc.createNestedObject("humidity");
+  hum["min"] = bucket.humidity.min;
+  hum["mean"] = bucket.humidity.sum / bucket.count;
+  hum["max"] = bucket.humidity.max;
+
+  JsonObject hr = doc.createNestedObject("heartRate");
+  hr["min"] = bucket.heartRate.min;
+  hr["mean"] = bucket.heartRate.sum / bucket.count;
+  hr["max"] = bucket.heartRate.max;
+
+  String payload;
+  serializeJson(doc, payload);
+
+  if (!mqttClient.publish(topic_rollup, payload.c_str())) {
+    return false;
+  }
+
+  Serial.println("   📤 [" + String(resolution) + "] " + payload);
+  return true;
+}
+
 // ==================== ENVIAR DADOS PARA NUVEM ====================
 bool sendDataToCloud(SensorData data) {
   if (!wifiConnected || !mqttConnected) {
@@ -580,6 +872,13 @@ bool sendDataToCloud(SensorData data) {
   doc["humidity"] = data.humidity;
   doc["heartRate"] = data.heartRate; // Chave CORRIGIDA para Node-RED
   doc["timestamp"] = data.timestamp;
+  doc["seq"] = data.seq;
+  doc["epoch"] = data.epoch;
+  doc["incarnation"] = data.incarnation;
+  doc["backlog_through"] = backlogThroughSeq;
+  // Referência para converter 'timestamp' em hora real (só vale para epoch == device_epoch)
+  doc["device_now"] = millis();
+  doc["device_epoch"] = bootEpoch;
   doc["battery"] = 85;
   doc["rssi"] = WiFi.RSSI();
   
@@ -643,6 +942,11 @@ void checkAlerts(SensorData data) {
       alertDoc["alert_level"] = (data.temperature > 38 || data.heartRate > 120) ? "CRITICAL" : "WARNING";
       alertDoc["message"] = alertMsg;
       alertDoc["timestamp"] = millis();
+      // Leitura de origem: o reenvio do backlog repete o alerta, e o consumidor
+      // descarta a cópia por (device_id, incarnation, seq)
+      alertDoc["seq"] = data.seq;
+      alertDoc["epoch"] = data.epoch;
+      alertDoc["incarnation"] = data.incarnation;
       
       String alertPayload;
       serializeJson(alertDoc, alertPayload);
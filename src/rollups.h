@@ -0,0 +1,138 @@
+/*
+ * Rollups multi-resolução (1 min / 1 h) dos dados offline
+ *
+ * Agregados incrementais (min/média/máx) das leituras feitas sem conexão.
+ * Ao reconectar eles são enviados antes do backlog bruto para preencher o
+ * dashboard imediatamente; as amostras brutas seguem depois, sem pressa.
+ *
+ * Em cascata: o minuto mais antigo que sai do anel de 1 min é somado ao anel
+ * de 1 h, então cada amostra está em um único nível (sem sobreposição). Com o
+ * anel de 1 h cheio, o trecho mais antigo da queda é descartado.
+ *
+ * Os anéis ficam só na RAM: todo bucket pertence ao boot atual.
+ * Sem dependência do Arduino - compilado também no host (test/rollups_test.cpp).
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+const unsigned long ROLLUP_MINUTE_MS = 60000UL;   // Resolução fina: 1 minuto
+const unsigned long ROLLUP_HOUR_MS = 3600000UL;   // Resolução grossa: 1 hora
+const int MAX_MINUTE_ROLLUPS = 60;                // Até 1h em resolução de 1 min
+const int MAX_HOUR_ROLLUPS = 24;                  // Até 24h em resolução de 1 h
+
+// Estatísticas de um canal dentro de um intervalo
+struct ChannelStats {
+  float min;
+  float max;
+  float sum;
+};
+
+// Agregado de um intervalo de tempo para todos os canais
+struct RollupBucket {
+  unsigned long key;    // Índice do intervalo (timestamp / resolução)
+  unsigned long start;  // Timestamp da primeira amostra
+  unsigned long end;    // Timestamp da última amostra
+  uint32_t seqFirst;    // Sequência da primeira amostra
+  uint32_t seqLast;     // Sequência da última amostra
+  int count;
+  ChannelStats temperature;
+  ChannelStats humidity;
+  ChannelStats heartRate;
+};
+
+// Anéis ordenados do mais antigo para o mais recente; só contêm o que ainda
+// não foi enviado (o envio remove o bucket do anel)
+struct RollupRings {
+  RollupBucket minute[MAX_MINUTE_ROLLUPS];
+  int minuteCount;
+  RollupBucket hour[MAX_HOUR_ROLLUPS];
+  int hourCount;
+};
+
+static inline void addToChannel(ChannelStats& stats, float value, bool first) {
+  if (first) {
+    stats.min = value;
+    stats.max = value;
+    stats.sum = value;
+    return;
+  }
+  if (value < stats.min) stats.min = value;
+  if (value > stats.max) stats.max = value;
+  stats.sum += value;
+}
+
+static inline void mergeChannel(ChannelStats& dst, const ChannelStats& src) {
+  if (src.min < dst.min) dst.min = src.min;
+  if (src.max > dst.max) dst.max = src.max;
+  dst.sum += src.sum;
+}
+
+// Remove o bucket mais antigo de um anel
+static inline void shiftRollupRing(RollupBucket* ring, int& count) {
+  if (count <= 0) {
+    return;
+  }
+  memmove(&ring[0], &ring[1], sizeof(RollupBucket) * (count - 1));
+  count--;
+}
+
+// Soma um bucket de 1 min que saiu do anel fino ao anel de 1 h
+static inline void mergeIntoHours(RollupRings& rings, const RollupBucket& minute) {
+  unsigned long key = minute.start / ROLLUP_HOUR_MS;
+
+  if (rings.hourCount == 0 || rings.hour[rings.hourCount - 1].key != key) {
+    if (rings.hourCount == MAX_HOUR_ROLLUPS) {
+      shiftRollupRing(rings.hour, rings.hourCount);
+    }
+    rings.hour[rings.hourCount] = minute;
+    rings.hour[rings.hourCount].key = key;
+    rings.hourCount++;
+    return;
+  }
+
+  RollupBucket& hour = rings.hour[rings.hourCount - 1];
+  mergeChannel(hour.temperature, minute.temperature);
+  mergeChannel(hour.humidity, minute.humidity);
+  mergeChannel(hour.heartRate, minute.heartRate);
+  hour.end = minute.end;
+  hour.seqLast = minute.seqLast;
+  hour.count += minute.count;
+}
+
+// Agrega uma leitura offline no bucket de 1 min correspondente
+static inline void addRollupSample(RollupRings& rings, unsigned long timestamp, uint32_t seq,
+                                   float temperature, float humidity, float heartRate) {
+  unsigned long key = timestamp / ROLLUP_MINUTE_MS;
+
+  // Amostra nova fora do último minuto: abrir outro bucket
+  if (rings.minuteCount == 0 || rings.minute[rings.minuteCount - 1].key != key) {
+    if (rings.minuteCount == MAX_MINUTE_ROLLUPS) {
+      // Minuto mais antigo desce para a resolução de 1 h
+      mergeIntoHours(rings, rings.minute[0]);
+      shiftRollupRing(rings.minute, rings.minuteCount);
+    }
+    RollupBucket& fresh = rings.minute[rings.minuteCount];
+    fresh.key = key;
+    fresh.start = timestamp;
+    fresh.seqFirst = seq;
+    fresh.count = 0;
+    rings.minuteCount++;
+  }
+
+  RollupBucket& bucket = rings.minute[rings.minuteCount - 1];
+  bool first = (bucket.count == 0);
+  addToChannel(bucket.temperature, temperature, first);
+  addToChannel(bucket.humidity, humidity, first);
+  addToChannel(bucket.heartRate, heartRate, first);
+  bucket.end = timestamp;
+  bucket.seqLast = seq;
+  bucket.count++;
+}
+
+static inline void clearRollups(RollupRings& rings) {
+  rings.minuteCount = 0;
+  rings.hourCount = 0;
+}
@@ -0,0 +1,381 @@
+/*
+ * TlsSessionClient - ver tls_session_client.h
+ */
+
+// Compilado apenas na variante TLS (env:esp32dev_tls)
+#ifdef MQTT_USE_TLS
+
+#include "tls_session_client.h"
+
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/version.h>
+
+// O estado do handshake é campo privado a partir do mbedTLS 3
+#if MBEDTLS_VERSION_MAJOR >= 3
+#define TLS_HANDSHAKE_OVER(ssl) mbedtls_ssl_is_handshake_over(ssl)
+#define TLS_STATE(ssl) ((ssl)->MBEDTLS_PRIVATE(state))
+#else
+#define TLS_HANDSHAKE_OVER(ssl) ((ssl)->state == MBEDTLS_SSL_HANDSHAKE_OVER)
+#define TLS_STATE(ssl) ((ssl)->state)
+#endif
+
+// Sessão serializada em memória RTC: preservada no deep sleep (não no reset)
+static const size_t RTC_SESSION_MAX = 2048;
+RTC_DATA_ATTR static uint8_t rtcSession[RTC_SESSION_MAX];
+RTC_DATA_ATTR static size_t rtcSessionLen = 0;
+
+// ==================== CONSTRUÇÃO ====================
+TlsSessionClient::TlsSessionClient()
+  : _caCert(nullptr),
+    _handshakeTimeout(10000),
+    _insecure(false),
+    _configured(false),
+    _sslActive(false),
+    _hasSession(false),
+    _peeked(-1),
+    _ioBytes(0) {
+  memset(&_stats, 0, sizeof(_stats));
+  mbedtls_ssl_init(&_ssl);
+  mbedtls_ssl_config_init(&_conf);
+  mbedtls_entropy_init(&_entropy);
+  mbedtls_ctr_drbg_init(&_drbg);
+  mbedtls_x509_crt_init(&_ca);
+  mbedtls_ssl_session_init(&_session);
+}
+
+TlsSessionClient::~TlsSessionClient() {
+  stop();
+  mbedtls_ssl_session_free(&_session);
+  mbedtls_x509_crt_free(&_ca);
+  mbedtls_ctr_drbg_free(&_drbg);
+  mbedtls_entropy_free(&_entropy);
+  mbedtls_ssl_config_free(&_conf);
+}
+
+void TlsSessionClient::setCACert(const char* pem) {
+  _caCert = pem;
+}
+
+void TlsSessionClient::setInsecure() {
+  _insecure = true;
+}
+
+void TlsSessionClient::setHandshakeTimeout(unsigned long timeoutMs) {
+  _handshakeTimeout = timeoutMs;
+}
+
+// ==================== CONFIGURAÇÃO (UMA VEZ) ====================
+bool TlsSessionClient::setupConfig() {
+  if (_configured) {
+    return true;
+  }
+
+  // Falha fechada: sem CA não há como autenticar o broker
+  if (_caCert == nullptr && !_insecure) {
+    return false;
+  }
+
+  const char* pers = "esp32_medical_tls";
+  if (mbedtls_ctr_drbg_seed(&_drbg, mbedtls_entropy_func, &_entropy,
+                            (const unsigned char*)pers, strlen(pers)) != 0) {
+    return false;
+  }
+
+  if (mbedtls_ssl_config_defaults(&_conf, MBEDTLS_SSL_IS_CLIENT,
+                                  MBEDTLS_SSL_TRANSPORT_STREAM,
+                                  MBEDTLS_SSL_PRESET_DEFAULT) != 0) {
+    return false;
+  }
+  mbedtls_ssl_conf_rng(&_conf, mbedtls_ctr_drbg_random, &_drbg);
+#if MBEDTLS_VERSION_MAJOR >= 3
+  // Retomada no TLS 1.3 não segue o fluxo ServerHello -> ChangeCipherSpec
+  mbedtls_ssl_conf_max_tls_version(&_conf, MBEDTLS_SSL_VERSION_TLS1_2);
+#endif
+
+  if (_caCert != nullptr) {
+    if (mbedtls_x509_crt_parse(&_ca, (const unsigned char*)_caCert, strlen(_caCert) + 1) != 0) {
+      return false;
+    }
+    mbedtls_ssl_conf_ca_chain(&_conf, &_ca, nullptr);
+    mbedtls_ssl_conf_authmode(&_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+  } else {
+    mbedtls_ssl_conf_authmode(&_conf, MBEDTLS_SSL_VERIFY_NONE);
+  }
+
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+  // Ticket quando o broker suporta; senão a retomada cai no ID de sessão
+  mbedtls_ssl_conf_session_tickets(&_conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+
+  restoreSession();
+  _configured = true;
+  return true;
+}
+
+// ==================== CONEXÃO ====================
+int TlsSessionClient::connect(IPAddress ip, uint16_t port) {
+  if (!setupConfig()) {
+    return 0;
+  }
+  stop();
+  if (!_tcp.connect(ip, port)) {
+    return 0;
+  }
+  return handshake(nullptr);
+}
+
+int TlsSessionClient::connect(const char* host, uint16_t port) {
+  if (!setupConfig()) {
+    return 0;
+  }
+  stop();
+  if (!_tcp.connect(host, port)) {
+    return 0;
+  }
+  return handshake(host);
+}
+
+int TlsSessionClient::handshake(const char* host) {
+  mbedtls_ssl_init(&_ssl);
+  if (mbedtls_ssl_setup(&_ssl, &_conf) != 0) {
+    mbedtls_ssl_free(&_ssl);
+    _tcp.stop();
+    return 0;
+  }
+  _sslActive = true;
+  _peeked = -1;
+
+  if (host != nullptr) {
+    mbedtls_ssl_set_hostname(&_ssl, host);
+  }
+  mbedtls_ssl_set_bio(&_ssl, this, bioSend, bioRecv, nullptr);
+
+  bool offered = _hasSession && mbedtls_ssl_set_session(&_ssl, &_session) == 0;
+
+  // Executa o handshake passo a passo: uma retomada aceita pelo broker
+  // pula direto do ServerHello para o ChangeCipherSpec, sem certificado
+  bool sawCertificate = false;
+  unsigned long startMs = millis();
+  _ioBytes = 0;
+
+  while (!TLS_HANDSHAKE_OVER(&_ssl)) {
+    if (TLS_STATE(&_ssl) == MBEDTLS_SSL_SERVER_CERTIFICATE) {
+      sawCertificate = true;
+    }
+
+    int ret = mbedtls_ssl_handshake_step(&_ssl);
+    if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+      if (millis() - startMs > _handshakeTimeout) {
+        stop();
+        return 0;
+      }
+      delay(1);
+      continue;
+    }
+    if (ret != 0) {
+      // Só um alerta fatal do broker indica sessão recusada (a próxima
+      // tentativa é completa). Broker que apenas não reconhece a sessão
+      // responde com handshake completo, sem erro; quedas do link
+      // (CONN_RESET, CONN_EOF) mantêm a sessão para a próxima reconexão.
+      if (offered && ret == MBEDTLS_ERR_SSL_FATAL_ALERT_MESSAGE) {
+        clearSession();
+      }
+      stop();
+      return 0;
+    }
+  }
+
+  bool resumed = offered && !sawCertificate;
+  unsigned long elapsed = millis() - startMs;
+
+  _stats.lastMs = elapsed;
+  _stats.lastBytes = _ioBytes;
+  _stats.lastResumed = resumed;
+  if (resumed) {
+    _stats.resumedCount++;
+    _stats.resumedMsTotal += elapsed;
+    _stats.resumedBytesTotal += _ioBytes;
+  } else {
+    _stats.fullCount++;
+    _stats.fullMsTotal += elapsed;
+    _stats.fullBytesTotal += _ioBytes;
+  }
+
+  saveSession();
+  return 1;
+}
+
+// ==================== CACHE DE SESSÃO ====================
+void TlsSessionClient::saveSession() {
+  mbedtls_ssl_session_free(&_session);
+  mbedtls_ssl_session_init(&_session);
+  _hasSession = (mbedtls_ssl_get_session(&_ssl, &_session) == 0);
+
+  rtcSessionLen = 0;
+  if (_hasSession) {
+    size_t len = 0;
+    if (mbedtls_ssl_session_save(&_session, rtcSession, RTC_SESSION_MAX, &len) == 0) {
+      rtcSessionLen = len;
+    }
+  }
+}
+
+void TlsSessionClient::restoreSession() {
+  if (rtcSessionLen == 0) {
+    return;
+  }
+  _hasSession = (mbedtls_ssl_session_load(&_session, rtcSession, rtcSessionLen) == 0);
+  if (!_hasSession) {
+    mbedtls_ssl_session_free(&_session);
+    mbedtls_ssl_session_init(&_session);
+    rtcSessionLen = 0;
+  }
+}
+
+void TlsSessionClient::clearSession() {
+  mbedtls_ssl_session_free(&_session);
+  mbedtls_ssl_session_init(&_session);
+  _hasSession = false;
+  rtcSessionLen = 0;
+}
+
+// ==================== E/S CIFRADA ====================
+size_t TlsSessionClient::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t TlsSessionClient::write(const uint8_t* buf, size_t size) {
+  if (!_sslActive) {
+    return 0;
+  }
+
+  size_t written = 0;
+  unsigned long startMs = millis();
+  while (written < size) {
+    int ret = mbedtls_ssl_write(&_ssl, buf + written, size - written);
+    if (ret > 0) {
+      written += ret;
+      continue;
+    }
+    if ((ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) &&
+        millis() - startMs < _handshakeTimeout) {
+      delay(1);
+      continue;
+    }
+    stop();
+    break;
+  }
+  return written;
+}
+
+int TlsSessionClient::available() {
+  if (!_sslActive) {
+    return 0;
+  }
+
+  int pending = (_peeked >= 0) ? 1 : 0;
+  if (mbedtls_ssl_get_bytes_avail(&_ssl) == 0 && _tcp.available() > 0) {
+    // Leitura vazia faz o mbedTLS decifrar o próximo registro disponível
+    int ret = mbedtls_ssl_read(&_ssl, nullptr, 0);
+    if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+      stop();
+      return 0;
+    }
+  }
+  return pending + mbedtls_ssl_get_bytes_avail(&_ssl);
+}
+
+int TlsSessionClient::read() {
+  uint8_t b;
+  return (read(&b, 1) == 1) ? b : -1;
+}
+
+int TlsSessionClient::read(uint8_t* buf, size_t size) {
+  if (!_sslActive || size == 0) {
+    return -1;
+  }
+
+  size_t offset = 0;
+  if (_peeked >= 0) {
+    buf[offset++] = (uint8_t)_peeked;
+    _peeked = -1;
+    if (offset == size) {
+      return offset;
+    }
+  }
+
+  int ret = mbedtls_ssl_read(&_ssl, buf + offset, size - offset);
+  if (ret > 0) {
+    return offset + ret;
+  }
+  if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+    stop();
+  }
+  return offset > 0 ? (int)offset : -1;
+}
+
+int TlsSessionClient::peek() {
+  if (_peeked < 0) {
+    uint8_t b;
+    if (available() > 0 && read(&b, 1) == 1) {
+      _peeked = b;
+    }
+  }
+  return _peeked;
+}
+
+void TlsSessionClient::flush() {
+  _tcp.flush();
+}
+
+void TlsSessionClient::stop() {
+  if (_sslActive) {
+    mbedtls_ssl_close_notify(&_ssl);
+    mbedtls_ssl_free(&_ssl);
+    _sslActive = false;
+  }
+  _peeked = -1;
+  _tcp.stop();
+}
+
+uint8_t TlsSessionClient::connected() {
+  if (!_sslActive) {
+    return 0;
+  }
+  return _tcp.connected() || mbedtls_ssl_get_bytes_avail(&_ssl) > 0 || _peeked >= 0;
+}
+
+TlsSessionClient::operator bool() {
+  return connected();
+}
+
+// ==================== CALLBACKS DE TRANSPORTE ====================
+int TlsSessionClient::bioSend(void* ctx, const unsigned char* buf, size_t len) {
+  TlsSessionClient* self = static_cast<TlsSessionClient*>(ctx);
+  if (!self->_tcp.connected()) {
+    return MBEDTLS_ERR_NET_CONN_RESET;
+  }
+
+  size_t sent = self->_tcp.write(buf, len);
+  if (sent == 0) {
+    return MBEDTLS_ERR_SSL_WANT_WRITE;
+  }
+  self->_ioBytes += sent;
+  return sent;
+}
+
+int TlsSessionClient::bioRecv(void* ctx, unsigned char* buf, size_t len) {
+  TlsSessionClient* self = static_cast<TlsSessionClient*>(ctx);
+  if (self->_tcp.available() <= 0) {
+    return self->_tcp.connected() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_SSL_CONN_EOF;
+  }
+
+  int received = self->_tcp.read(buf, len);
+  if (received <= 0) {
+    return MBEDTLS_ERR_SSL_WANT_READ;
+  }
+  self->_ioBytes += received;
+  return received;
+}
+
+#endif // MQTT_USE_TLS
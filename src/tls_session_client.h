@@ -0,0 +1,93 @@
+/*
+ * TlsSessionClient - Transporte TLS para o PubSubClient com retomada de sessão
+ *
+ * Implementa a interface Client do Arduino sobre um WiFiClient usando o mbedTLS
+ * do ESP32 diretamente, para ter acesso ao que o WiFiClientSecure não expõe:
+ * 1. Sessão TLS (ID ou ticket) guardada entre reconexões -> handshake abreviado
+ * 2. Cópia da sessão em memória RTC -> sobrevive ao deep sleep
+ * 3. Medição de cada handshake (tempo e bytes trafegados, completo x retomado)
+ *
+ * Escrito para o mbedTLS 2.28 do arduino-esp32 2.0.x (ESP-IDF 4.4), fixado
+ * em env:esp32dev_tls. No mbedTLS 3.x o TLS fica limitado à versão 1.2, para
+ * que a detecção de retomada (ausência do certificado) continue válida.
+ *
+ * Sem CA configurada a conexão é recusada, a menos que setInsecure() seja
+ * chamado explicitamente.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/x509_crt.h>
+
+// Custo acumulado dos handshakes TLS
+struct TlsHandshakeStats {
+  unsigned long fullCount;
+  unsigned long fullMsTotal;
+  unsigned long fullBytesTotal;
+  unsigned long resumedCount;
+  unsigned long resumedMsTotal;
+  unsigned long resumedBytesTotal;
+  unsigned long lastMs;
+  unsigned long lastBytes;
+  bool lastResumed;
+};
+
+class TlsSessionClient : public Client {
+public:
+  TlsSessionClient();
+  ~TlsSessionClient();
+
+  // PEM da CA do broker (obrigatório, salvo setInsecure())
+  void setCACert(const char* pem);
+  // Aceita qualquer certificado do broker - apenas testes locais
+  void setInsecure();
+  void setHandshakeTimeout(unsigned long timeoutMs);
+
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char* host, uint16_t port) override;
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buf, size_t size) override;
+  int peek() override;
+  void flush() override;
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override;
+
+  bool hasSession() const { return _hasSession; }
+  void clearSession();
+  const TlsHandshakeStats& stats() const { return _stats; }
+
+private:
+  bool setupConfig();
+  int handshake(const char* host);
+  void saveSession();
+  void restoreSession();
+  static int bioSend(void* ctx, const unsigned char* buf, size_t len);
+  static int bioRecv(void* ctx, unsigned char* buf, size_t len);
+
+  WiFiClient _tcp;
+  mbedtls_ssl_context _ssl;
+  mbedtls_ssl_config _conf;
+  mbedtls_entropy_context _entropy;
+  mbedtls_ctr_drbg_context _drbg;
+  mbedtls_x509_crt _ca;
+  mbedtls_ssl_session _session;
+
+  const char* _caCert;
+  unsigned long _handshakeTimeout;
+  bool _insecure;
+  bool _configured;
+  bool _sslActive;
+  bool _hasSession;
+  int _peeked;
+  size_t _ioBytes;
+  TlsHandshakeStats _stats;
+};
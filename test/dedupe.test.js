@@ -0,0 +1,161 @@
+// Testes no host do nó "Dedupe + reordenação" (fn_dedupe) do nodered_flow.json:
+// o código da função é carregado do próprio fluxo e executado como no Node-RED.
+const test = require('node:test');
+const assert = require('node:assert');
+const fs = require('node:fs');
+const path = require('node:path');
+
+const flow = JSON.parse(fs.readFileSync(path.join(__dirname, '..', 'nodered_flow.json'), 'utf8'));
+const source = flow.find(n => n.id === 'fn_dedupe').func;
+
+// Instancia o nó com contexto, status e temporizadores controlados pelo teste
+function createNode() {
+  const store = {};
+  const timers = [];
+  const delivered = [];
+  const context = { get: k => store[k], set: (k, v) => { store[k] = v; } };
+  const node = {
+    status() {},
+    send(outputs) { for (const m of outputs[0]) delivered.push(m); },
+  };
+  const setTimer = (fn) => { const t = { fn, live: true }; timers.push(t); return t; };
+  const clearTimer = (t) => { if (t) t.live = false; };
+  const fn = new Function('msg', 'context', 'node', 'setTimeout', 'clearTimeout', source);
+
+  return {
+    delivered,
+    receive(payload) {
+      const result = fn({ payload }, context, node, setTimer, clearTimer);
+      if (result === null || result === undefined) return;
+      if (Array.isArray(result)) delivered.push(...result[0]);
+      else delivered.push(result);
+    },
+    pendingTimers: () => timers.filter(t => t.live).length,
+    fireTimers() { for (const t of timers.splice(0)) if (t.live) t.fn(); },
+  };
+}
+
+function record(seq, extra) {
+  return { device_id: 'ESP32_Medical_001_LCV', incarnation: 0xA5A5, epoch: 1, seq, ...extra };
+}
+
+function countBySeq(delivered) {
+  const counts = new Map();
+  for (const m of delivered) counts.set(m.payload.seq, (counts.get(m.payload.seq) || 0) + 1);
+  return counts;
+}
+
+test('duplicatas e reordenação em alta taxa: cada seq exatamente uma vez', () => {
+  const n = createNode();
+  const N = 50000;
+
+  // Pseudoaleatório determinístico para o teste ser reprodutível
+  let seed = 42;
+  const rand = () => (seed = (seed * 1103515245 + 12345) % 2147483648) / 2147483648;
+
+  const stream = [];
+  for (let s = 1; s <= N; s++) {
+    stream.push(s);
+    if (rand() < 0.3) stream.push(s);
+  }
+  for (let i = 0; i < stream.length; i += 12) {
+    const block = stream.slice(i, i + 12).sort(() => rand() - 0.5);
+    stream.splice(i, block.length, ...block);
+  }
+  for (let s = N - 800; s < N - 200; s++) stream.push(s); // Reenvio do backlog
+
+  for (const s of stream) {
+    n.receive(record(s));
+    if (rand() < 0.02) n.fireTimers();
+  }
+  n.fireTimers();
+
+  const counts = countBySeq(n.delivered);
+  assert.strictEqual(counts.size, N);
+  for (let s = 1; s <= N; s++) assert.strictEqual(counts.get(s), 1, `seq ${s}`);
+});
+
+test('sem retenção expirada, saída estritamente crescente (exceto o backlog)', () => {
+  const n = createNode();
+  const N = 20000;
+  const GAP = 99; // Seqs N+1..N+99 gravados offline durante a queda
+
+  let seed = 7;
+  const rand = () => (seed = (seed * 1103515245 + 12345) % 2147483648) / 2147483648;
+  // Reordenação local (blocos de 12) com duplicatas; o primeiro registro chega primeiro
+  function shuffled(first, last) {
+    const out = [];
+    for (let s = first; s <= last; s++) {
+      out.push(s);
+      if (rand() < 0.3) out.push(s);
+    }
+    for (let i = 1; i < out.length; i += 12) {
+      const block = out.slice(i, i + 12).sort(() => rand() - 0.5);
+      out.splice(i, block.length, ...block);
+    }
+    return out;
+  }
+
+  for (const s of shuffled(1, N)) n.receive(record(s, { backlog_through: 0 }));
+
+  // Após a queda: ao vivo reordenado, backlog drenado em paralelo (1 a cada 3)
+  const live = shuffled(N + GAP + 1, N + GAP + 300);
+  let backlog = N + 1;
+  live.forEach((s, i) => {
+    n.receive(record(s, { backlog_through: N + GAP }));
+    if (i % 3 === 0 && backlog <= N + GAP) n.receive(record(backlog++, { backlog_through: N + GAP }));
+  });
+  while (backlog <= N + GAP) n.receive(record(backlog++, { backlog_through: N + GAP }));
+
+  // Nenhuma retenção expirou: tudo saiu por lacunas preenchidas
+  assert.strictEqual(n.pendingTimers(), 0);
+
+  const seqs = n.delivered.map(m => m.payload.seq);
+  const isBacklog = s => s > N && s <= N + GAP;
+  const increasing = list => list.every((s, i) => i === 0 || s > list[i - 1]);
+  assert.strictEqual(seqs.length, N + GAP + 300);
+  assert.ok(increasing(seqs.filter(s => !isBacklog(s))), 'leituras ao vivo fora de ordem');
+  assert.ok(increasing(seqs.filter(isBacklog)), 'backlog fora de ordem');
+});
+
+test('backlog antigo nunca visto é entregue, mesmo além da janela', () => {
+  const n = createNode();
+  for (let s = 2000; s <= 3200; s++) n.receive(record(s));
+  for (let s = 1000; s <= 1999; s++) n.receive(record(s));
+
+  const counts = countBySeq(n.delivered);
+  for (let s = 1000; s <= 3200; s++) assert.strictEqual(counts.get(s), 1, `seq ${s}`);
+
+  // Além do bitmap: entregue sinalizado, não descartado
+  for (let s = 3201; s <= 9000; s++) n.receive(record(s));
+  n.receive(record(500));
+  const old = n.delivered.filter(m => m.payload.seq === 500);
+  assert.strictEqual(old.length, 1);
+  assert.strictEqual(old[0].beyondWindow, true);
+});
+
+test('NVS apagada (nova encarnação, epoch e seq recomeçam) não é descartada', () => {
+  const n = createNode();
+  for (let s = 1; s <= 5000; s++) n.receive(record(s, { epoch: 40 }));
+  const before = n.delivered.length;
+
+  for (let s = 1; s <= 50; s++) n.receive(record(s, { epoch: 1, incarnation: 0x1234 }));
+  n.fireTimers();
+
+  assert.strictEqual(n.delivered.length - before, 50);
+});
+
+test('leitura ao vivo após queda não espera a lacuna coberta pelo backlog', () => {
+  const n = createNode();
+  for (let s = 1; s <= 10; s++) n.receive(record(s, { backlog_through: 0 }));
+
+  // 11..19 gravados offline; primeira leitura ao vivo declara a lacuna
+  n.receive(record(20, { backlog_through: 19 }));
+  assert.deepStrictEqual(n.delivered.map(m => m.payload.seq).slice(-1), [20]);
+  assert.strictEqual(n.pendingTimers(), 0);
+
+  // Backlog chega depois e é entregue direto, sem duplicar a leitura ao vivo
+  for (let s = 11; s <= 20; s++) n.receive(record(s, { backlog_through: 20 }));
+  const counts = countBySeq(n.delivered);
+  for (let s = 1; s <= 20; s++) assert.strictEqual(counts.get(s), 1, `seq ${s}`);
+});
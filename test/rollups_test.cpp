@@ -0,0 +1,171 @@
+// Testes no host dos anéis de agregados (src/rollups.h), o mesmo código que
+// roda no ESP32. Compilado com g++ pelo test/CMakeLists.txt (npm run test:host).
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "rollups.h"
+
+static int failures = 0;
+
+#define CHECK(cond)                                                        \
+  do {                                                                     \
+    if (!(cond)) {                                                         \
+      printf("    FALHOU %s:%d: %s\n", __FILE__, __LINE__, #cond);         \
+      failures++;                                                          \
+    }                                                                      \
+  } while (0)
+
+const unsigned long SENSOR_INTERVAL = 5000;  // readSensors(): uma leitura a cada 5 s
+const unsigned long RAW_SYNC_INTERVAL = 2000; // syncOfflineData(): um registro a cada 2 s
+const int MAX_STORED_READINGS = 1000;        // Anel de amostras offline do firmware
+
+static RollupRings rings;
+
+// Queda de 'outageMs' começando em 'startMs': uma amostra a cada SENSOR_INTERVAL
+static uint32_t feedOutage(unsigned long startMs, unsigned long outageMs, uint32_t firstSeq) {
+  uint32_t seq = firstSeq;
+  for (unsigned long ts = startMs; ts < startMs + outageMs; ts += SENSOR_INTERVAL) {
+    addRollupSample(rings, ts, seq, 36.0f + (seq % 10) * 0.1f, 60.0f, 70.0f + (seq % 7));
+    seq++;
+  }
+  return seq;
+}
+
+static int totalCount() {
+  int n = 0;
+  for (int i = 0; i < rings.hourCount; i++) n += rings.hour[i].count;
+  for (int i = 0; i < rings.minuteCount; i++) n += rings.minute[i].count;
+  return n;
+}
+
+// Buckets em ordem (1 h depois 1 min) cobrem seqs contíguos, sem sobreposição
+static void checkContiguous() {
+  const RollupBucket* prev = nullptr;
+  for (int i = 0; i < rings.hourCount + rings.minuteCount; i++) {
+    const RollupBucket& b = i < rings.hourCount ? rings.hour[i] : rings.minute[i - rings.hourCount];
+    CHECK(b.seqLast - b.seqFirst + 1 == (uint32_t)b.count);
+    if (prev != nullptr) {
+      CHECK(prev->end < b.start);
+      CHECK(prev->seqLast + 1 == b.seqFirst);
+    }
+    prev = &b;
+  }
+}
+
+static void testNoOverlap() {
+  printf("  anéis de 1 min e 1 h não se sobrepõem (queda de 3 h)\n");
+  clearRollups(rings);
+  uint32_t next = feedOutage(0, 3 * ROLLUP_HOUR_MS, 1);
+
+  CHECK(rings.minuteCount == MAX_MINUTE_ROLLUPS);
+  CHECK(rings.hourCount == 2);
+  CHECK(totalCount() == (int)(next - 1));
+  CHECK(rings.hour[rings.hourCount - 1].end < rings.minute[0].start);
+  checkContiguous();
+}
+
+static void testStats() {
+  printf("  min/média/máx por bucket\n");
+  clearRollups(rings);
+  addRollupSample(rings, 1000, 1, 36.0f, 50.0f, 70.0f);
+  addRollupSample(rings, 6000, 2, 38.0f, 52.0f, 90.0f);
+  addRollupSample(rings, 11000, 3, 37.0f, 51.0f, 80.0f);
+  addRollupSample(rings, ROLLUP_MINUTE_MS, 4, 40.0f, 40.0f, 40.0f);
+
+  CHECK(rings.minuteCount == 2);
+  const RollupBucket& b = rings.minute[0];
+  CHECK(b.count == 3);
+  CHECK(b.temperature.min == 36.0f && b.temperature.max == 38.0f && b.temperature.sum == 111.0f);
+  CHECK(b.heartRate.min == 70.0f && b.heartRate.max == 90.0f);
+  CHECK(b.start == 1000 && b.end == 11000);
+}
+
+static void testHourRingFull() {
+  printf("  anel de 1 h cheio descarta o trecho mais antigo\n");
+  clearRollups(rings);
+  uint32_t next = feedOutage(0, 30 * ROLLUP_HOUR_MS, 1);
+
+  CHECK(rings.hourCount == MAX_HOUR_ROLLUPS);
+  CHECK(rings.minuteCount == MAX_MINUTE_ROLLUPS);
+  // 30 h: a última hora está no anel fino; as 24 anteriores no anel de 1 h
+  CHECK(rings.hour[0].key == 5);
+  CHECK(rings.minute[rings.minuteCount - 1].seqLast == next - 1);
+  checkContiguous();
+}
+
+static void testPartialSync() {
+  printf("  envio parcial seguido de nova queda não reenvia nem mistura\n");
+  clearRollups(rings);
+  uint32_t next = feedOutage(0, 2 * ROLLUP_HOUR_MS, 1);
+
+  // Como syncRollups(): cada bucket enviado sai do anel; falha após 1 h + 10 min
+  uint32_t sentThrough = rings.hour[0].seqLast;
+  shiftRollupRing(rings.hour, rings.hourCount);
+  for (int i = 0; i < 10; i++) {
+    sentThrough = rings.minute[0].seqLast;
+    shiftRollupRing(rings.minute, rings.minuteCount);
+  }
+
+  // Nova queda logo em seguida empurra minutos pendentes para o anel de 1 h
+  next = feedOutage(2 * ROLLUP_HOUR_MS, 2 * ROLLUP_HOUR_MS, next);
+
+  CHECK(rings.hour[0].seqFirst == sentThrough + 1);
+  CHECK(totalCount() == (int)(next - 1 - sentThrough));
+  checkContiguous();
+}
+
+// ---- Modelo (não é teste do firmware): tempo até cobrir a queda ----
+// Dreno bruto: um registro a cada RAW_SYNC_INTERVAL, em ordem de chegada, com
+// cada leitura ao vivo também enfileirada por storeData() atrás do backlog.
+// Agregados: todos os buckets em uma única passada de syncRollups().
+static void modelCoverage(const char* label, unsigned long outageMs) {
+  clearRollups(rings);
+  int samples = (int)(outageMs / SENSOR_INTERVAL);
+  feedOutage(0, outageMs, 1);
+  int publishes = rings.hourCount + rings.minuteCount;
+
+  char raw[64];
+  char drained[64];
+  if (samples > MAX_STORED_READINGS) {
+    snprintf(raw, sizeof(raw), "nunca cobre (anel de %d sobrescrito)", MAX_STORED_READINGS);
+  } else {
+    snprintf(raw, sizeof(raw), "cobre em %lu s", (samples - 1) * RAW_SYNC_INTERVAL / 1000);
+  }
+
+  // Fila esvazia quando os envios alcançam backlog + leituras novas
+  int backlog = samples < MAX_STORED_READINGS ? samples : MAX_STORED_READINGS;
+  int queued = backlog;
+  unsigned long t = 0;
+  int sent = 0;
+  while (sent < queued) {
+    sent++;
+    t += RAW_SYNC_INTERVAL;
+    queued = backlog + (int)(t / SENSOR_INTERVAL);
+  }
+  snprintf(drained, sizeof(drained), "%lu s", t / 1000);
+
+  printf("    queda %-8s | só brutos: %s, fila vazia em %s | agregados: %d publicações em uma passada\n",
+         label, raw, drained, publishes);
+  CHECK(publishes < samples || samples <= 1);
+  CHECK(totalCount() == samples);
+}
+
+int main() {
+  printf("rollups.h\n");
+  testNoOverlap();
+  testStats();
+  testHourRingFull();
+  testPartialSync();
+
+  printf("  modelo de cobertura após reconectar\n");
+  modelCoverage("45 s", 45000);
+  modelCoverage("10 min", 10 * ROLLUP_MINUTE_MS);
+  modelCoverage("3 h", 3 * ROLLUP_HOUR_MS);
+
+  if (failures > 0) {
+    printf("%d verificações falharam\n", failures);
+    return EXIT_FAILURE;
+  }
+  printf("ok\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,34 @@
+// Testes no host do nó "Extrair medidas + alerta" (fn_split) do nodered_flow.json
+const test = require('node:test');
+const assert = require('node:assert');
+const fs = require('node:fs');
+const path = require('node:path');
+
+const flow = JSON.parse(fs.readFileSync(path.join(__dirname, '..', 'nodered_flow.json'), 'utf8'));
+const split = new Function('msg', flow.find(n => n.id === 'fn_split').func);
+
+function record(extra) {
+  return { temperature: 36.5, heartRate: 72, timestamp: 100000, seq: 50, epoch: 3,
+           backlog_through: 40, device_now: 100500, device_epoch: 3, ...extra };
+}
+
+test('leitura ao vivo: gráficos na hora da medição, gauge, valores e alerta', () => {
+  const before = Date.now();
+  const out = split({ payload: record() });
+  assert.strictEqual(out.length, 5);
+  for (const m of out) assert.ok(m);
+  assert.ok(out[0].timestamp >= before - 500 && out[0].timestamp <= Date.now() - 500);
+  assert.strictEqual(out[1].timestamp, out[0].timestamp);
+});
+
+test('backlog da queda: só nos gráficos, na hora em que foi medido', () => {
+  // Medido 10 min antes do envio
+  const out = split({ payload: record({ seq: 30, timestamp: 100000, device_now: 700000 }) });
+  assert.deepStrictEqual(out.slice(2), [null, null, null]);
+  const age = Date.now() - out[0].timestamp;
+  assert.ok(age >= 600000 && age < 601000, `idade ${age}`);
+});
+
+test('backlog de boot anterior: sem referência de tempo, fora dos gráficos', () => {
+  assert.strictEqual(split({ payload: record({ seq: 30, epoch: 2 }) }), null);
+});